@@ -8,6 +8,7 @@
 #include <unistd.h>
 #include <math.h>
 
+#include "geo.h"
 #include "dataset.h"
 
 static int endsWith(const char *str, const char *suffix);
@@ -27,6 +28,8 @@ struct context {
     struct dataset_list datasets;
     size_t num_datasets;
     char *auth;
+    int compressionLevel;
+    size_t compressionThreshold;
 };
 
 struct context *ContextCreate(const char *path, const char *srs, const char *auth) {
@@ -82,10 +85,30 @@ const char *ContextAuth(struct context *ctx) {
     return ctx->auth;
 }
 
+// Replies of at least 'threshold' bytes are compressed at 'level' when the
+// client accepts it, and a level of 0 disables compression.
+void ContextSetCompression(struct context *ctx, int level, size_t threshold) {
+    ctx->compressionLevel = level;
+    ctx->compressionThreshold = threshold;
+}
+
+int ContextCompressionLevel(struct context *ctx) {
+    return ctx->compressionLevel;
+}
+
+size_t ContextCompressionThreshold(struct context *ctx) {
+    return ctx->compressionThreshold;
+}
+
 int ContextEmpty(struct context *ctx) {
     return LIST_EMPTY(&ctx->datasets);
 }
 
+int ContextIsGeographic(struct context *ctx) {
+    struct dataset_item *item = LIST_FIRST(&ctx->datasets);
+    return item && DatasetIsGeographic(item->dataset);
+}
+
 double ContextGetAltitude(struct context *ctx, double x, double y) {
     struct dataset_item *item;
     double alt;
@@ -98,6 +121,76 @@ double ContextGetAltitude(struct context *ctx, double x, double y) {
     return NAN;
 }
 
+void ContextGetAltitudes(struct context *ctx, int n, const double *x, const double *y, double *z) {
+    struct dataset_item *item;
+    for (int i = 0; i < n; i++) {
+        z[i] = NAN;
+    }
+    LIST_FOREACH(item, &ctx->datasets, entry) {
+        DatasetGetAltitudes(item->dataset, n, x, y, z);
+    }
+}
+
+// Fills 3x3 windows around the points, laid out as in DatasetGetWindows,
+// along with cell sizes in meters (NAN if not covered). Neighbors falling
+// off the raster of their point are looked up in the adjacent datasets,
+// assuming they share the same grid.
+void ContextGetWindows(struct context *ctx, int n, const double *x, const double *y, double *win, double *dx, double *dy) {
+    struct dataset_item *item;
+    int m = 0, geographic = ContextIsGeographic(ctx);
+    double *mx = NULL, *my = NULL, *mz = NULL;
+    unsigned char *off = (unsigned char *) calloc(n * 9 + 1, 1);
+    for (int i = 0; i < n; i++) {
+        dx[i] = dy[i] = NAN;
+    }
+    for (int i = 0; i < n * 9; i++) {
+        win[i] = NAN;
+    }
+    if (!off) {
+        return;
+    }
+    LIST_FOREACH(item, &ctx->datasets, entry) {
+        DatasetGetWindows(item->dataset, n, x, y, win, off, dx, dy);
+    }
+    for (int i = 0; i < n * 9; i++) {
+        if (off[i]) {
+            m++;
+        }
+    }
+    if (m == 0) {
+        goto done;
+    }
+    mx = (double *) malloc(sizeof(double) * m);
+    my = (double *) malloc(sizeof(double) * m);
+    mz = (double *) malloc(sizeof(double) * m);
+    if (mx && my && mz) {
+        for (int i = 0, j = 0; i < n * 9; i++) {
+            int p = i % n, r = i / n / 3, c = i / n % 3;
+            if (off[i]) {
+                GeoOffset(geographic, x[p], y[p], (c - 1) * dx[p], (1 - r) * dy[p], &mx[j], &my[j]);
+                j++;
+            }
+        }
+        ContextGetAltitudes(ctx, m, mx, my, mz);
+        for (int i = 0, j = 0; i < n * 9; i++) {
+            if (off[i]) {
+                win[i] = mz[j++];
+            }
+        }
+    }
+done:
+    free(off);
+    if (mx) {
+        free(mx);
+    }
+    if (my) {
+        free(my);
+    }
+    if (mz) {
+        free(mz);
+    }
+}
+
 void contextAddDataset(struct context *ctx, const char *filepath, const char *srs) {
     struct dataset *dataset = DatasetCreate(filepath, srs);
     if (dataset) {
@@ -1,11 +1,19 @@
 #ifndef CONTEXT_H_
 #define CONTEXT_H_
 
+#include <stddef.h>
+
 struct context;
 struct context *ContextCreate(const char *, const char *, const char *);
 void ContextFree(struct context *);
 const char *ContextAuth(struct context *ctx);
+void ContextSetCompression(struct context *ctx, int level, size_t threshold);
+int ContextCompressionLevel(struct context *ctx);
+size_t ContextCompressionThreshold(struct context *ctx);
 int ContextEmpty(struct context *ctx);
+int ContextIsGeographic(struct context *ctx);
 double ContextGetAltitude(struct context *, double, double);
+void ContextGetAltitudes(struct context *, int n, const double *x, const double *y, double *z);
+void ContextGetWindows(struct context *, int n, const double *x, const double *y, double *win, double *dx, double *dy);
 
 #endif // CONTEXT_H_
@@ -8,11 +8,39 @@
 #include <gdal/ogr_spatialref.h>
 #endif
 
+#include "geo.h"
 #include "dataset.h"
 
 static char *sanitizeSRS(const char *);
 static int datasetGetBounds(dataset *ctx);
 static int datasetGetCorner(dataset *, double *, double *);
+static int datasetLocate(dataset *, int, const double *, const double *, const double *, int *, int *, int *);
+static void datasetSortByTile(dataset *, int, int *, int *, int *);
+static int compareLocations(const void *, const void *);
+static struct dataset_tile *datasetGetTile(dataset *, int, int);
+static double datasetGetPixel(dataset *, int, int);
+static void datasetGetWindow(dataset *, int, int, double *, unsigned char *, int);
+
+// Batched lookups read the raster in aligned tiles which are kept in a small
+// LRU cache, visiting the points of a batch tile by tile.
+#define DATASET_TILE_SIZE 256
+#define DATASET_NUM_TILES 8
+
+struct dataset_location {
+    int tile;
+    int index;
+    int pixel;
+    int line;
+};
+
+struct dataset_tile {
+    int xOff;
+    int yOff;
+    int xSize;
+    int ySize;
+    unsigned long used;
+    double *data;
+};
 
 struct dataset {
     char *filename;
@@ -30,6 +58,8 @@ struct dataset {
     double left;
     double bottom;
     double right;
+    struct dataset_tile tiles[DATASET_NUM_TILES];
+    unsigned long tick;
 };
 
 dataset *DatasetCreate(const char *filename, const char *srs) {
@@ -134,6 +164,11 @@ void DatasetFree(struct dataset *ctx) {
     if (ctx->hSrcDS) {
         GDALClose(ctx->hSrcDS);
     }
+    for (int i = 0; i < DATASET_NUM_TILES; i++) {
+        if (ctx->tiles[i].data) {
+            free(ctx->tiles[i].data);
+        }
+    }
     free(ctx);
 }
 
@@ -141,6 +176,10 @@ const char *DatasetFilename(struct dataset *ctx) {
     return ctx->filename;
 }
 
+int DatasetIsGeographic(struct dataset *ctx) {
+    return OSRIsGeographic(ctx->hSrcSRS);
+}
+
 double DatasetGetAltitude(struct dataset *ctx, double dfGeoX, double dfGeoY) {
     if (dfGeoX < ctx->left || dfGeoX > ctx->right || dfGeoY < ctx->bottom || dfGeoY > ctx->top) {
         return NAN;
@@ -175,6 +214,66 @@ double DatasetGetAltitude(struct dataset *ctx, double dfGeoX, double dfGeoY) {
     return NAN;
 }
 
+// Fills altitudes of the points covered by this dataset, leaving the points
+// that already have an altitude (i.e. not NAN) untouched.
+void DatasetGetAltitudes(struct dataset *ctx, int n, const double *x, const double *y, double *z) {
+    int *index = (int *) malloc(sizeof(int) * n);
+    int *pixels = (int *) malloc(sizeof(int) * n);
+    int *lines = (int *) malloc(sizeof(int) * n);
+    if (index && pixels && lines) {
+        int m = datasetLocate(ctx, n, x, y, z, index, pixels, lines);
+        for (int j = 0; j < m; j++) {
+            z[index[j]] = datasetGetPixel(ctx, pixels[j], lines[j]);
+        }
+    }
+    if (index) {
+        free(index);
+    }
+    if (pixels) {
+        free(pixels);
+    }
+    if (lines) {
+        free(lines);
+    }
+}
+
+// Fills 3x3 windows around the points covered by this dataset, along with
+// the cell size in meters. Windows are planar: neighbor k (0-8, rows from
+// north to south) of point i is at win[k * n + i].
+// Points that already have a cell size (i.e. not NAN in 'dx') are left
+// untouched. Neighbors off this raster are left NAN and flagged in 'off',
+// unlike neighbors without data.
+void DatasetGetWindows(struct dataset *ctx, int n, const double *x, const double *y, double *win, unsigned char *off,
+                        double *dx, double *dy) {
+    int *index = (int *) malloc(sizeof(int) * n);
+    int *pixels = (int *) malloc(sizeof(int) * n);
+    int *lines = (int *) malloc(sizeof(int) * n);
+    if (index && pixels && lines) {
+        int geographic = OSRIsGeographic(ctx->hTrgSRS);
+        double scale = geographic ? GEO_EARTH_RADIUS * M_PI / 180.0 : OSRGetLinearUnits(ctx->hTrgSRS, NULL);
+        int m = datasetLocate(ctx, n, x, y, dx, index, pixels, lines);
+        for (int j = 0; j < m; j++) {
+            int i = index[j];
+            datasetGetWindow(ctx, pixels[j], lines[j], &win[i], &off[i], n);
+            dx[i] = fabs(ctx->adfGeoTransform[1]) * scale;
+            dy[i] = fabs(ctx->adfGeoTransform[5]) * scale;
+            if (geographic) {
+                double lat = ctx->adfGeoTransform[3] + ctx->adfGeoTransform[5] * (lines[j] + 0.5);
+                dx[i] *= cos(lat * M_PI / 180.0);
+            }
+        }
+    }
+    if (index) {
+        free(index);
+    }
+    if (pixels) {
+        free(pixels);
+    }
+    if (lines) {
+        free(lines);
+    }
+}
+
 void DatasetGetBounds(struct dataset *ctx, double *t, double *l, double *b, double *r) {
     *t = ctx->top;
     *l = ctx->left;
@@ -220,6 +319,178 @@ int datasetGetCorner(struct dataset *ctx, double *x, double *y) {
     return OCTTransform(ctx->hInvCT, 1, x, y, &z);
 }
 
+// Locates pixels of the points within this dataset which are still pending
+// (i.e. NAN in 'pending'), and returns the number of them. Located points
+// are grouped by tile, so every tile is read once per batch whatever the
+// order of the points is.
+int datasetLocate(struct dataset *ctx, int n, const double *x, const double *y, const double *pending,
+                    int *index, int *pixels, int *lines) {
+    double *px = (double *) malloc(sizeof(double) * n);
+    double *py = (double *) malloc(sizeof(double) * n);
+    int *success = (int *) malloc(sizeof(int) * n);
+    int m = 0, k = 0;
+    if (!px || !py || !success) {
+        goto done;
+    }
+    for (int i = 0; i < n; i++) {
+        if (!isnan(pending[i]) || !isfinite(x[i]) || !isfinite(y[i]) || x[i] < ctx->left || x[i] > ctx->right || y[i] < ctx->bottom || y[i] > ctx->top) {
+            continue;
+        }
+        px[m] = x[i];
+        py[m] = y[i];
+        index[m] = i;
+        m++;
+    }
+    if (m == 0 || !OCTTransformEx(ctx->hCT, m, px, py, NULL, success)) {
+        goto done;
+    }
+    for (int j = 0; j < m; j++) {
+        if (!success[j]) {
+            continue;
+        }
+        int iPixel = (int) floor(
+            ctx->adfInvGeoTransform[0]
+            + ctx->adfInvGeoTransform[1] * px[j]
+            + ctx->adfInvGeoTransform[2] * py[j]);
+        int iLine = (int) floor(
+            ctx->adfInvGeoTransform[3]
+            + ctx->adfInvGeoTransform[4] * px[j]
+            + ctx->adfInvGeoTransform[5] * py[j]);
+        if (iPixel < 0 || iLine < 0
+                || iPixel >= GDALGetRasterXSize(ctx->hSrcDS)
+                || iLine  >= GDALGetRasterYSize(ctx->hSrcDS)) {
+            continue;
+        }
+        index[k] = index[j];
+        pixels[k] = iPixel;
+        lines[k] = iLine;
+        k++;
+    }
+    datasetSortByTile(ctx, k, index, pixels, lines);
+done:
+    if (px) {
+        free(px);
+    }
+    if (py) {
+        free(py);
+    }
+    if (success) {
+        free(success);
+    }
+    return k;
+}
+
+void datasetSortByTile(struct dataset *ctx, int n, int *index, int *pixels, int *lines) {
+    if (n < 2) {
+        return;
+    }
+    struct dataset_location *locations = (struct dataset_location *) malloc(sizeof(struct dataset_location) * n);
+    if (!locations) {
+        return;
+    }
+    int tilesPerRow = (GDALGetRasterXSize(ctx->hSrcDS) + DATASET_TILE_SIZE - 1) / DATASET_TILE_SIZE;
+    for (int i = 0; i < n; i++) {
+        locations[i].tile = lines[i] / DATASET_TILE_SIZE * tilesPerRow + pixels[i] / DATASET_TILE_SIZE;
+        locations[i].index = index[i];
+        locations[i].pixel = pixels[i];
+        locations[i].line = lines[i];
+    }
+    qsort(locations, n, sizeof(struct dataset_location), compareLocations);
+    for (int i = 0; i < n; i++) {
+        index[i] = locations[i].index;
+        pixels[i] = locations[i].pixel;
+        lines[i] = locations[i].line;
+    }
+    free(locations);
+}
+
+int compareLocations(const void *a, const void *b) {
+    const struct dataset_location *la = (const struct dataset_location *) a;
+    const struct dataset_location *lb = (const struct dataset_location *) b;
+    if (la->tile != lb->tile) {
+        return la->tile < lb->tile ? -1 : 1;
+    }
+    return la->index < lb->index ? -1 : (la->index > lb->index ? 1 : 0);
+}
+
+struct dataset_tile *datasetGetTile(struct dataset *ctx, int iPixel, int iLine) {
+    int xSize = GDALGetRasterXSize(ctx->hSrcDS);
+    int ySize = GDALGetRasterYSize(ctx->hSrcDS);
+    if (iPixel < 0 || iLine < 0 || iPixel >= xSize || iLine >= ySize) {
+        return NULL;
+    }
+    int xOff = iPixel - iPixel % DATASET_TILE_SIZE;
+    int yOff = iLine - iLine % DATASET_TILE_SIZE;
+    struct dataset_tile *tile = NULL;
+    for (int i = 0; i < DATASET_NUM_TILES; i++) {
+        struct dataset_tile *t = &ctx->tiles[i];
+        if (t->data && t->xOff == xOff && t->yOff == yOff) {
+            tile = t;
+            break;
+        }
+        if (!tile || !t->data || (tile->data && t->used < tile->used)) {
+            tile = t;
+        }
+    }
+    if (!tile->data || tile->xOff != xOff || tile->yOff != yOff) {
+        if (!tile->data) {
+            tile->data = (double *) malloc(sizeof(double) * DATASET_TILE_SIZE * DATASET_TILE_SIZE);
+            if (!tile->data) {
+                return NULL;
+            }
+        }
+        tile->xOff = xOff;
+        tile->yOff = yOff;
+        tile->xSize = xSize - xOff < DATASET_TILE_SIZE ? xSize - xOff : DATASET_TILE_SIZE;
+        tile->ySize = ySize - yOff < DATASET_TILE_SIZE ? ySize - yOff : DATASET_TILE_SIZE;
+        if (GDALRasterIO(ctx->hBand, GF_Read, xOff, yOff, tile->xSize, tile->ySize,
+                            tile->data, tile->xSize, tile->ySize, GDT_Float64, 0, 0) != CE_None) {
+            free(tile->data);
+            tile->data = NULL;
+            return NULL;
+        }
+    }
+    tile->used = ++ctx->tick;
+    return tile;
+}
+
+double datasetGetPixel(struct dataset *ctx, int iPixel, int iLine) {
+    struct dataset_tile *tile = datasetGetTile(ctx, iPixel, iLine);
+    if (!tile) {
+        return NAN;
+    }
+    double value = tile->data[(iLine - tile->yOff) * tile->xSize + (iPixel - tile->xOff)];
+    if (value == ctx->NoDataValue) {
+        return NAN;
+    }
+    return value;
+}
+
+// Reads the window from the tile of the center pixel in one go, and only
+// looks up neighbors individually when the window straddles tiles. The 9
+// values (and flags of neighbors off the raster) are written 'stride' apart.
+void datasetGetWindow(struct dataset *ctx, int iPixel, int iLine, double *win, unsigned char *off, int stride) {
+    int sx = ctx->adfGeoTransform[1] < 0 ? -1 : 1;
+    int sy = ctx->adfGeoTransform[5] > 0 ? -1 : 1;
+    int xSize = GDALGetRasterXSize(ctx->hSrcDS);
+    int ySize = GDALGetRasterYSize(ctx->hSrcDS);
+    struct dataset_tile *tile = datasetGetTile(ctx, iPixel, iLine);
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            int p = iPixel + (c - 1) * sx;
+            int l = iLine + (r - 1) * sy;
+            off[(r * 3 + c) * stride] = p < 0 || l < 0 || p >= xSize || l >= ySize;
+            if (tile && p >= tile->xOff && p < tile->xOff + tile->xSize
+                    && l >= tile->yOff && l < tile->yOff + tile->ySize) {
+                double value = tile->data[(l - tile->yOff) * tile->xSize + (p - tile->xOff)];
+                win[(r * 3 + c) * stride] = value == ctx->NoDataValue ? NAN : value;
+            } else {
+                win[(r * 3 + c) * stride] = datasetGetPixel(ctx, p, l);
+            }
+        }
+    }
+}
+
 char *sanitizeSRS(const char *pszUserInput) {
     OGRSpatialReferenceH hSRS;
     char *pszResult = NULL;
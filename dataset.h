@@ -6,6 +6,9 @@ struct dataset *DatasetCreate(const char *, const char *);
 void DatasetFree(struct dataset *);
 const char *DatasetFilename(struct dataset *ctx);
 void DatasetGetBounds(struct dataset *, double *t, double *l, double *b, double *r);
+int DatasetIsGeographic(struct dataset *);
 double DatasetGetAltitude(struct dataset *, double, double);
+void DatasetGetAltitudes(struct dataset *, int n, const double *x, const double *y, double *z);
+void DatasetGetWindows(struct dataset *, int n, const double *x, const double *y, double *win, unsigned char *off, double *dx, double *dy);
 
 #endif // DATASET_H_
@@ -8,35 +8,23 @@
 #include <json-c/json.h>
 
 #include "context.h"
+#include "request.h"
 
 #include "elevation.h"
 
-static const char *contentType = "application/json; charset=utf-8";
-
 void elevation_request_cb(struct evhttp_request *req, void *arg) {
     context *ctx = (context *)arg;
-    char *data = NULL;
     json_object *coords, *json = NULL, *result = NULL;
-    size_t len;
     int n;
-    evbuffer *input, *output = NULL;
+    evbuffer *output = NULL;
 
-    switch (evhttp_request_get_command(req)) {
-    case EVHTTP_REQ_POST:
-        break;
-    default:
-        evhttp_send_error(req, 405, NULL);
+    if (!RequestAccept(req, ctx)) {
         return;
     }
 
-    const char *auth = ContextAuth(ctx);
-    if (auth) {
-        struct evkeyvalq *headers = evhttp_request_get_input_headers(req);
-        const char *value = evhttp_find_header(headers, "Authorization");
-        if (!value || strcmp(auth, value)) {
-            evhttp_send_error(req, 401, NULL);
-            return;
-        }
+    json = RequestParseJSON(req);
+    if (!json) {
+        return;
     }
 
     output = evbuffer_new();
@@ -45,31 +33,6 @@ void elevation_request_cb(struct evhttp_request *req, void *arg) {
         goto err;
     }
 
-    input = evhttp_request_get_input_buffer(req);
-    if (!input) {
-        fprintf(stderr, "Failed to get input buffer: %s\n", strerror(errno));
-        goto err;
-    }
-
-    len = evbuffer_get_length(input);
-    if (len <= 0) {
-        evhttp_send_error(req, 400, NULL);
-        goto done;
-    }
-
-    data = (char *) malloc(len);
-    if (evbuffer_copyout(input, data, len) != len) {
-        fprintf(stderr, "Failed to drain input buffer: %s\n", strerror(errno));
-        goto err;
-    }
-
-    json_tokener_error err;
-    json = json_tokener_parse_verbose(data, &err);
-    if (!json) {
-        fprintf(stderr, "Failed to parse input buffer: %s\n", json_tokener_error_desc(err));
-        goto err;
-    }
-    
     if (!json_object_is_type(json, json_type_array)) {
         evhttp_send_error(req, 400, NULL);
         goto done;
@@ -129,8 +92,7 @@ void elevation_request_cb(struct evhttp_request *req, void *arg) {
         }
         fprintf(stderr, "Lookup %d point(s) in %ld.%06ld sec\n", n, sec, usec);
     }
-    evhttp_add_header(evhttp_request_get_output_headers(req), "Content-Type", contentType);
-    evhttp_send_reply(req, 200, "OK", output);
+    RequestSendReply(req, ctx, output);
     goto done;
 err:
     evhttp_send_error(req, 500, NULL);
@@ -144,7 +106,4 @@ done:
     if (json) {
         json_object_put(json);
     }
-    if (data) {
-        free(data);
-    }
 }
@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+
+#include <event2/buffer.h>
+#include <zlib.h>
+#include <zstd.h>
+
+#include "encoding.h"
+
+#define ENCODING_CHUNK 16384
+
+static int compressZlib(int windowBits, int level, struct evbuffer *input, struct evbuffer *output);
+static int compressZstd(int level, struct evbuffer *input, struct evbuffer *output);
+static struct evbuffer_iovec *peekChunks(struct evbuffer *input, int *n);
+
+// Returns the encoding of a 'Content-Encoding' token, or -1 if unsupported.
+int EncodingParse(const char *name) {
+    if (!strcasecmp(name, "identity")) {
+        return ENCODING_IDENTITY;
+    } else if (!strcasecmp(name, "deflate")) {
+        return ENCODING_DEFLATE;
+    } else if (!strcasecmp(name, "gzip") || !strcasecmp(name, "x-gzip")) {
+        return ENCODING_GZIP;
+    } else if (!strcasecmp(name, "zstd")) {
+        return ENCODING_ZSTD;
+    }
+    return -1;
+}
+
+// Returns the encoding of a 'Content-Encoding' header, which lists the
+// codings applied in order. Whitespace and identity codings are ignored,
+// and -1 is returned for unsupported codings or more than one of them.
+int EncodingParseHeader(const char *contentEncoding) {
+    char *header = strdup(contentEncoding);
+    if (!header) {
+        return -1;
+    }
+    int result = ENCODING_IDENTITY;
+    char *save = NULL;
+    for (char *token = strtok_r(header, ",", &save); token; token = strtok_r(NULL, ",", &save)) {
+        token += strspn(token, " \t");
+        token[strcspn(token, " \t")] = '\0';
+        int encoding = *token ? EncodingParse(token) : ENCODING_IDENTITY;
+        if (encoding == ENCODING_IDENTITY) {
+            continue;
+        }
+        if (encoding < 0 || result != ENCODING_IDENTITY) {
+            result = -1;
+            break;
+        }
+        result = encoding;
+    }
+    free(header);
+    return result;
+}
+
+const char *EncodingName(int encoding) {
+    switch (encoding) {
+    case ENCODING_DEFLATE: return "deflate";
+    case ENCODING_GZIP: return "gzip";
+    case ENCODING_ZSTD: return "zstd";
+    default: return "identity";
+    }
+}
+
+// Picks the supported encoding with the highest q-value in an
+// 'Accept-Encoding' header, preferring zstd, then gzip, then deflate on ties.
+int EncodingNegotiate(const char *acceptEncoding) {
+    static const int preferred[] = { ENCODING_ZSTD, ENCODING_GZIP, ENCODING_DEFLATE };
+    double q[ENCODING_ZSTD + 1] = { -1, -1, -1, -1 };
+    double any = -1;
+    if (!acceptEncoding) {
+        return ENCODING_IDENTITY;
+    }
+    char *header = strdup(acceptEncoding);
+    if (!header) {
+        return ENCODING_IDENTITY;
+    }
+    char *save = NULL;
+    for (char *token = strtok_r(header, ",", &save); token; token = strtok_r(NULL, ",", &save)) {
+        double value = 1;
+        char *params = strchr(token, ';');
+        if (params) {
+            *params++ = '\0';
+            const char *qs = strstr(params, "q=");
+            if (qs) {
+                value = atof(qs + 2);
+            }
+        }
+        token += strspn(token, " \t");
+        token[strcspn(token, " \t")] = '\0';
+        if (!strcmp(token, "*")) {
+            any = value;
+        } else {
+            int encoding = EncodingParse(token);
+            if (encoding >= 0) {
+                q[encoding] = value;
+            }
+        }
+    }
+    free(header);
+    int best = ENCODING_IDENTITY;
+    double bestQ = 0;
+    for (size_t i = 0; i < sizeof(preferred) / sizeof(preferred[0]); i++) {
+        double value = q[preferred[i]] >= 0 ? q[preferred[i]] : any;
+        if (value > bestQ) {
+            best = preferred[i];
+            bestQ = value;
+        }
+    }
+    return best;
+}
+
+// Streams the input buffer through the compressor straight into the output
+// buffer's own space, without flattening either of them.
+int EncodingCompress(int encoding, int level, struct evbuffer *input, struct evbuffer *output) {
+    switch (encoding) {
+    case ENCODING_DEFLATE:
+        return compressZlib(MAX_WBITS, level, input, output);
+    case ENCODING_GZIP:
+        return compressZlib(MAX_WBITS + 16, level, input, output);
+    case ENCODING_ZSTD:
+        return compressZstd(level, input, output);
+    default:
+        return -1;
+    }
+}
+
+// Inflates a gzip or deflate input buffer into a NUL-terminated string, or
+// returns NULL with errno set to EMSGSIZE if it exceeds 'max' bytes, EINVAL
+// if it is corrupted, or ENOTSUP for other encodings.
+char *EncodingDecompress(int encoding, struct evbuffer *input, size_t max, size_t *len) {
+    if (encoding != ENCODING_GZIP && encoding != ENCODING_DEFLATE) {
+        errno = ENOTSUP;
+        return NULL;
+    }
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // Let zlib detect the gzip or zlib header by itself.
+    if (inflateInit2(&zs, MAX_WBITS + 32) != Z_OK) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    int n, z = Z_OK;
+    size_t size = ENCODING_CHUNK;
+    char *data = (char *) malloc(size + 1);
+    struct evbuffer_iovec *chunks = peekChunks(input, &n);
+    if (!data || !chunks) {
+        errno = ENOMEM;
+        goto err;
+    }
+    for (int i = 0; i < n && z != Z_STREAM_END; i++) {
+        zs.next_in = (Bytef *) chunks[i].iov_base;
+        zs.avail_in = chunks[i].iov_len;
+        while (zs.avail_in > 0 && z != Z_STREAM_END) {
+            if (zs.total_out == size) {
+                if (size >= max) {
+                    errno = EMSGSIZE;
+                    goto err;
+                }
+                size = size * 2 < max ? size * 2 : max;
+                char *grown = (char *) realloc(data, size + 1);
+                if (!grown) {
+                    errno = ENOMEM;
+                    goto err;
+                }
+                data = grown;
+            }
+            zs.next_out = (Bytef *) data + zs.total_out;
+            zs.avail_out = size - zs.total_out;
+            z = inflate(&zs, Z_NO_FLUSH);
+            if (z != Z_OK && z != Z_STREAM_END) {
+                errno = EINVAL;
+                goto err;
+            }
+        }
+    }
+    if (z != Z_STREAM_END) {
+        errno = EINVAL;
+        goto err;
+    }
+    *len = zs.total_out;
+    data[*len] = '\0';
+    inflateEnd(&zs);
+    free(chunks);
+    return data;
+err:
+    inflateEnd(&zs);
+    if (chunks) {
+        free(chunks);
+    }
+    if (data) {
+        free(data);
+    }
+    return NULL;
+}
+
+int compressZlib(int windowBits, int level, struct evbuffer *input, struct evbuffer *output) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, level > Z_BEST_COMPRESSION ? Z_BEST_COMPRESSION : level,
+                        Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return -1;
+    }
+    int n, z = Z_OK;
+    struct evbuffer_iovec *chunks = peekChunks(input, &n);
+    if (!chunks) {
+        deflateEnd(&zs);
+        return -1;
+    }
+    for (int i = 0; i <= n && z != Z_STREAM_ERROR; i++) {
+        int flush = i < n ? Z_NO_FLUSH : Z_FINISH;
+        zs.next_in = i < n ? (Bytef *) chunks[i].iov_base : NULL;
+        zs.avail_in = i < n ? chunks[i].iov_len : 0;
+        do {
+            struct evbuffer_iovec vec;
+            if (evbuffer_reserve_space(output, ENCODING_CHUNK, &vec, 1) < 1) {
+                z = Z_STREAM_ERROR;
+                break;
+            }
+            zs.next_out = (Bytef *) vec.iov_base;
+            zs.avail_out = vec.iov_len;
+            z = deflate(&zs, flush);
+            vec.iov_len -= zs.avail_out;
+            evbuffer_commit_space(output, &vec, 1);
+        } while (z != Z_STREAM_ERROR && (zs.avail_out == 0 || (flush == Z_FINISH && z != Z_STREAM_END)));
+    }
+    deflateEnd(&zs);
+    free(chunks);
+    return z == Z_STREAM_END ? 0 : -1;
+}
+
+int compressZstd(int level, struct evbuffer *input, struct evbuffer *output) {
+    ZSTD_CStream *cs = ZSTD_createCStream();
+    if (!cs) {
+        return -1;
+    }
+    int n, ret = 0;
+    size_t remaining;
+    struct evbuffer_iovec *chunks = NULL;
+    if (ZSTD_isError(ZSTD_initCStream(cs, level > ZSTD_maxCLevel() ? ZSTD_maxCLevel() : level))) {
+        ret = -1;
+        goto done;
+    }
+    chunks = peekChunks(input, &n);
+    if (!chunks) {
+        ret = -1;
+        goto done;
+    }
+    for (int i = 0; i < n && ret == 0; i++) {
+        ZSTD_inBuffer in = { chunks[i].iov_base, chunks[i].iov_len, 0 };
+        while (in.pos < in.size) {
+            struct evbuffer_iovec vec;
+            if (evbuffer_reserve_space(output, ENCODING_CHUNK, &vec, 1) < 1) {
+                ret = -1;
+                break;
+            }
+            ZSTD_outBuffer out = { vec.iov_base, vec.iov_len, 0 };
+            size_t r = ZSTD_compressStream(cs, &out, &in);
+            vec.iov_len = out.pos;
+            evbuffer_commit_space(output, &vec, 1);
+            if (ZSTD_isError(r)) {
+                ret = -1;
+                break;
+            }
+        }
+    }
+    do {
+        struct evbuffer_iovec vec;
+        if (ret != 0 || evbuffer_reserve_space(output, ENCODING_CHUNK, &vec, 1) < 1) {
+            ret = -1;
+            break;
+        }
+        ZSTD_outBuffer out = { vec.iov_base, vec.iov_len, 0 };
+        remaining = ZSTD_endStream(cs, &out);
+        vec.iov_len = out.pos;
+        evbuffer_commit_space(output, &vec, 1);
+        if (ZSTD_isError(remaining)) {
+            ret = -1;
+            break;
+        }
+    } while (remaining > 0);
+done:
+    ZSTD_freeCStream(cs);
+    if (chunks) {
+        free(chunks);
+    }
+    return ret;
+}
+
+struct evbuffer_iovec *peekChunks(struct evbuffer *input, int *n) {
+    *n = evbuffer_peek(input, -1, NULL, NULL, 0);
+    struct evbuffer_iovec *chunks = (struct evbuffer_iovec *) malloc(sizeof(struct evbuffer_iovec) * (*n + 1));
+    if (chunks) {
+        evbuffer_peek(input, -1, NULL, chunks, *n);
+    }
+    return chunks;
+}
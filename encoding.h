@@ -0,0 +1,22 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <stddef.h>
+
+struct evbuffer;
+
+enum encoding {
+    ENCODING_IDENTITY,
+    ENCODING_DEFLATE,
+    ENCODING_GZIP,
+    ENCODING_ZSTD,
+};
+
+int EncodingParse(const char *name);
+int EncodingParseHeader(const char *contentEncoding);
+const char *EncodingName(int encoding);
+int EncodingNegotiate(const char *acceptEncoding);
+int EncodingCompress(int encoding, int level, struct evbuffer *input, struct evbuffer *output);
+char *EncodingDecompress(int encoding, struct evbuffer *input, size_t max, size_t *len);
+
+#endif // ENCODING_H
@@ -0,0 +1,35 @@
+#include <math.h>
+
+#include "geo.h"
+
+static double radians(double deg) {
+    return deg * M_PI / 180.0;
+}
+
+static double degrees(double rad) {
+    return rad * 180.0 / M_PI;
+}
+
+// Distance in meters between two points. Geographic coordinates are
+// longitude/latitude in degrees, otherwise they are taken as meters.
+double GeoDistance(int geographic, double x0, double y0, double x1, double y1) {
+    if (!geographic) {
+        return hypot(x1 - x0, y1 - y0);
+    }
+    double dLat = radians(y1 - y0);
+    double dLon = radians(x1 - x0);
+    double a = sin(dLat / 2) * sin(dLat / 2)
+        + cos(radians(y0)) * cos(radians(y1)) * sin(dLon / 2) * sin(dLon / 2);
+    return 2 * GEO_EARTH_RADIUS * asin(sqrt(a));
+}
+
+// Moves a point by dx meters eastward and dy meters northward.
+void GeoOffset(int geographic, double x, double y, double dx, double dy, double *ox, double *oy) {
+    if (!geographic) {
+        *ox = x + dx;
+        *oy = y + dy;
+        return;
+    }
+    *ox = x + degrees(dx / (GEO_EARTH_RADIUS * cos(radians(y))));
+    *oy = y + degrees(dy / GEO_EARTH_RADIUS);
+}
@@ -0,0 +1,9 @@
+#ifndef GEO_H_
+#define GEO_H_
+
+#define GEO_EARTH_RADIUS 6371008.8
+
+double GeoDistance(int geographic, double x0, double y0, double x1, double y1);
+void GeoOffset(int geographic, double x, double y, double dx, double dy, double *ox, double *oy);
+
+#endif // GEO_H_
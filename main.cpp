@@ -16,6 +16,8 @@
 #include <math.h>
 
 #include "elevation.h"
+#include "visibility.h"
+#include "terrain.h"
 #include "context.h"
 
 static void do_term(int sig, short events, void *arg) {
@@ -28,7 +30,12 @@ static const char *defaultAddress = "0.0.0.0";
 static const int defaultPort = 80;
 static const char *defaultSRS = "WGS84";
 static const char *defaultURI = "/v1/elevations";
+static const char *losURI = "/v1/los";
+static const char *viewshedURI = "/v1/viewshed";
+static const char *terrainURI = "/v1/terrain";
 static const char *defaultAuth = "";
+static const int defaultCompressionLevel = 6;
+static const int defaultCompressionThreshold = 1024;
 
 int main(int argc, char **argv) {
     struct context *ctx = NULL;
@@ -41,14 +48,18 @@ int main(int argc, char **argv) {
     const char *srs = defaultSRS;
     const char *uri = defaultURI;
     const char *auth = defaultAuth;
+    int level = defaultCompressionLevel;
+    int threshold = defaultCompressionThreshold;
 
-    while ((opt = getopt(argc, argv, "a:p:u:s:A:")) != -1) {
+    while ((opt = getopt(argc, argv, "a:p:u:s:A:z:Z:")) != -1) {
 		switch (opt) {
 			case 'a': addr = optarg; break;
 			case 'p': port = atoi(optarg); break;
 			case 'u': uri = optarg; break;
 			case 's': srs = optarg; break;
 			case 'A': auth = optarg; break;
+			case 'z': level = atoi(optarg); break;
+			case 'Z': threshold = atoi(optarg); break;
 			default : fprintf(stderr, "Unknown option %c\n", opt); break;
 		}
 	}
@@ -61,6 +72,8 @@ int main(int argc, char **argv) {
 		fprintf(stdout, "    -u <URI>  : URI to serve REST (default: %s)\n", defaultURI);
 		fprintf(stdout, "    -s <SRS>  : SRS of requested coordinates (default: %s)\n", defaultSRS);
 		fprintf(stdout, "    -A <auth> : 'Authorization' header to control access, 401 status will be replied if not matched. (default: none)\n");
+		fprintf(stdout, "    -z <level>: Compression level of replies, 0 to disable (default: %d)\n", defaultCompressionLevel);
+		fprintf(stdout, "    -Z <bytes>: Minimum size of replies to compress (default: %d)\n", defaultCompressionThreshold);
 		exit(1);
 	}
 
@@ -72,6 +85,8 @@ int main(int argc, char **argv) {
 		goto err;
     }
 
+	ContextSetCompression(ctx, level < 0 ? 0 : level, threshold < 0 ? 0 : threshold);
+
 	if (ContextEmpty(ctx)) {
 		fprintf(stderr, "No DEM found: %s\n", path);
 		ret = 1;
@@ -99,6 +114,9 @@ int main(int argc, char **argv) {
 	}
 
     evhttp_set_cb(http, uri, elevation_request_cb, ctx);
+    evhttp_set_cb(http, losURI, los_request_cb, ctx);
+    evhttp_set_cb(http, viewshedURI, viewshed_request_cb, ctx);
+    evhttp_set_cb(http, terrainURI, terrain_request_cb, ctx);
 
     handle = evhttp_bind_socket_with_handle(http, addr, port);
 	if (!handle) {
@@ -121,6 +139,9 @@ int main(int argc, char **argv) {
     }
 
     fprintf(stderr, "Serving http://%s:%d%s\n", addr, port, uri);
+    fprintf(stderr, "Serving http://%s:%d%s\n", addr, port, losURI);
+    fprintf(stderr, "Serving http://%s:%d%s\n", addr, port, viewshedURI);
+    fprintf(stderr, "Serving http://%s:%d%s\n", addr, port, terrainURI);
 	ret = event_base_dispatch(base);
 
 err:
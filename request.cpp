@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/time.h>
+#include <math.h>
+
+#include <event2/buffer.h>
+#include <event2/http.h>
+#include <json-c/json.h>
+
+#include "context.h"
+#include "encoding.h"
+
+#include "request.h"
+
+static const char *contentType = "application/json; charset=utf-8";
+static const size_t maxBodySize = 64 * 1024 * 1024;
+
+// Only POST is served, and the 'Authorization' header has to match when
+// the context is protected. An error is replied and 0 is returned otherwise.
+int RequestAccept(struct evhttp_request *req, struct context *ctx) {
+    switch (evhttp_request_get_command(req)) {
+    case EVHTTP_REQ_POST:
+        break;
+    default:
+        evhttp_send_error(req, 405, NULL);
+        return 0;
+    }
+
+    const char *auth = ContextAuth(ctx);
+    if (auth) {
+        struct evkeyvalq *headers = evhttp_request_get_input_headers(req);
+        const char *value = evhttp_find_header(headers, "Authorization");
+        if (!value || strcmp(auth, value)) {
+            evhttp_send_error(req, 401, NULL);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Parses the request body as JSON, inflating it first if it comes with a
+// gzip or deflate 'Content-Encoding'. An error is replied and NULL is
+// returned on failure, otherwise the caller owns the returned object.
+json_object *RequestParseJSON(struct evhttp_request *req) {
+    json_object *json = NULL;
+    char *data = NULL;
+    const char *contentEncoding;
+    int encoding;
+    size_t len;
+
+    evbuffer *input = evhttp_request_get_input_buffer(req);
+    if (!input) {
+        fprintf(stderr, "Failed to get input buffer: %s\n", strerror(errno));
+        goto err;
+    }
+
+    len = evbuffer_get_length(input);
+    if (len <= 0) {
+        evhttp_send_error(req, 400, NULL);
+        return NULL;
+    }
+
+    contentEncoding = evhttp_find_header(evhttp_request_get_input_headers(req), "Content-Encoding");
+    encoding = contentEncoding ? EncodingParseHeader(contentEncoding) : ENCODING_IDENTITY;
+    if (encoding == ENCODING_IDENTITY) {
+        data = (char *) malloc(len + 1);
+        if (!data) {
+            fprintf(stderr, "Failed to allocate input data: %s\n", strerror(errno));
+            goto err;
+        }
+        if (evbuffer_copyout(input, data, len) != (ev_ssize_t) len) {
+            fprintf(stderr, "Failed to drain input buffer: %s\n", strerror(errno));
+            goto err;
+        }
+        data[len] = '\0';
+    } else {
+        data = EncodingDecompress(encoding, input, maxBodySize, &len);
+        if (!data) {
+            int error = errno;
+            fprintf(stderr, "Failed to decompress input buffer: %s\n", strerror(error));
+            switch (error) {
+            case ENOTSUP: evhttp_send_error(req, 415, NULL); break;
+            case EMSGSIZE: evhttp_send_error(req, 413, NULL); break;
+            case EINVAL: evhttp_send_error(req, 400, NULL); break;
+            default: evhttp_send_error(req, 500, NULL); break;
+            }
+            return NULL;
+        }
+    }
+
+    json_tokener_error err;
+    json = json_tokener_parse_verbose(data, &err);
+    if (!json) {
+        fprintf(stderr, "Failed to parse input buffer: %s\n", json_tokener_error_desc(err));
+        goto err;
+    }
+    free(data);
+    return json;
+err:
+    evhttp_send_error(req, 500, NULL);
+    if (data) {
+        free(data);
+    }
+    return NULL;
+}
+
+// Replies the output, compressed with the best encoding the client accepts
+// unless it is smaller than the threshold of the context.
+void RequestSendReply(struct evhttp_request *req, struct context *ctx, struct evbuffer *output) {
+    struct evkeyvalq *headers = evhttp_request_get_output_headers(req);
+    evhttp_add_header(headers, "Content-Type", contentType);
+    int level = ContextCompressionLevel(ctx);
+    if (level > 0) {
+        evhttp_add_header(headers, "Vary", "Accept-Encoding");
+    }
+    if (level > 0 && evbuffer_get_length(output) >= ContextCompressionThreshold(ctx)) {
+        const char *acceptEncoding = evhttp_find_header(evhttp_request_get_input_headers(req), "Accept-Encoding");
+        int encoding = EncodingNegotiate(acceptEncoding);
+        if (encoding != ENCODING_IDENTITY) {
+            evbuffer *compressed = evbuffer_new();
+            if (compressed && EncodingCompress(encoding, level, output, compressed) == 0) {
+                evhttp_add_header(headers, "Content-Encoding", EncodingName(encoding));
+                evhttp_send_reply(req, 200, "OK", compressed);
+                evbuffer_free(compressed);
+                return;
+            }
+            fprintf(stderr, "Failed to compress output buffer: %s\n", EncodingName(encoding));
+            if (compressed) {
+                evbuffer_free(compressed);
+            }
+        }
+    }
+    evhttp_send_reply(req, 200, "OK", output);
+}
+
+void RequestSendJSON(struct evhttp_request *req, struct context *ctx, json_object *json) {
+    evbuffer *output = evbuffer_new();
+    if (!output) {
+        fprintf(stderr, "Failed to allocate output buffer: %s\n", strerror(errno));
+        evhttp_send_error(req, 500, NULL);
+        return;
+    }
+    const char *string = json_object_to_json_string(json);
+    if (evbuffer_add(output, string, strlen(string)) != 0
+            || evbuffer_add(output, "\n", 1) != 0) {
+        fprintf(stderr, "Failed to dump JSON string: %s\n", strerror(errno));
+        evhttp_send_error(req, 500, NULL);
+    } else {
+        RequestSendReply(req, ctx, output);
+    }
+    evbuffer_free(output);
+}
+
+void RequestLogElapsed(const char *what, int n, struct timeval *start) {
+    struct timeval end;
+    gettimeofday(&end, NULL);
+    time_t sec = end.tv_sec - start->tv_sec;
+    time_t usec = end.tv_usec - start->tv_usec;
+    if (usec < 0) {
+        usec += 1000000;
+        sec--;
+    }
+    fprintf(stderr, "%s %d point(s) in %ld.%06ld sec\n", what, n, sec, usec);
+}
+
+// Reads a finite number, which may be a JSON integer or double.
+int RequestGetNumber(json_object *obj, double *val) {
+    if (!json_object_is_type(obj, json_type_double) && !json_object_is_type(obj, json_type_int)) {
+        return 0;
+    }
+    *val = json_object_get_double(obj);
+    return isfinite(*val);
+}
+
+// Reads a [x,y] coordinate of finite numbers.
+int RequestGetPoint(json_object *obj, double *x, double *y) {
+    return json_object_is_type(obj, json_type_array)
+        && json_object_array_length(obj) == 2
+        && RequestGetNumber(json_object_array_get_idx(obj, 0), x)
+        && RequestGetNumber(json_object_array_get_idx(obj, 1), y);
+}
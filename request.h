@@ -0,0 +1,18 @@
+#ifndef REQUEST_H
+#define REQUEST_H
+
+struct evhttp_request;
+struct evbuffer;
+struct json_object;
+struct context;
+struct timeval;
+
+int RequestAccept(struct evhttp_request *req, struct context *ctx);
+struct json_object *RequestParseJSON(struct evhttp_request *req);
+void RequestSendReply(struct evhttp_request *req, struct context *ctx, struct evbuffer *output);
+void RequestSendJSON(struct evhttp_request *req, struct context *ctx, struct json_object *json);
+void RequestLogElapsed(const char *what, int n, struct timeval *start);
+int RequestGetNumber(struct json_object *obj, double *val);
+int RequestGetPoint(struct json_object *obj, double *x, double *y);
+
+#endif // REQUEST_H
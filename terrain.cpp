@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include <event2/buffer.h>
+#include <event2/http.h>
+#include <json-c/json.h>
+
+#include "context.h"
+#include "request.h"
+
+#include "terrain.h"
+
+static const int maxTerrainPoints = 100000;
+
+static void horn(int n, const double *win, const double *dx, const double *dy,
+                    double *__restrict east, double *__restrict north,
+                    double *slope, double *aspect, double *__restrict tri);
+
+// Replies slope and aspect (in degrees, aspect clockwise from north and
+// facing downhill) and optionally the terrain ruggedness index of every
+// point, or null for points without DTM coverage.
+void terrain_request_cb(struct evhttp_request *req, void *arg) {
+    context *ctx = (context *)arg;
+    json_object *json = NULL, *points, *opt, *result = NULL;
+    double *xs = NULL, *ys = NULL, *win = NULL, *dx = NULL, *dy = NULL;
+    double *east = NULL, *north = NULL, *slope = NULL, *aspect = NULL, *tri = NULL;
+    int n, withTRI = 0;
+    struct timeval start;
+
+    if (!RequestAccept(req, ctx)) {
+        return;
+    }
+
+    json = RequestParseJSON(req);
+    if (!json) {
+        return;
+    }
+
+    if (!json_object_is_type(json, json_type_object)
+            || !json_object_object_get_ex(json, "points", &points)
+            || !json_object_is_type(points, json_type_array)) {
+        evhttp_send_error(req, 400, NULL);
+        goto done;
+    }
+    if (json_object_object_get_ex(json, "tri", &opt)) {
+        if (!json_object_is_type(opt, json_type_boolean)) {
+            evhttp_send_error(req, 400, NULL);
+            goto done;
+        }
+        withTRI = json_object_get_boolean(opt);
+    }
+
+    n = json_object_array_length(points);
+    if (n > maxTerrainPoints) {
+        evhttp_send_error(req, 400, NULL);
+        goto done;
+    }
+
+    gettimeofday(&start, NULL);
+    xs = (double *) malloc(sizeof(double) * (n + 1));
+    ys = (double *) malloc(sizeof(double) * (n + 1));
+    win = (double *) malloc(sizeof(double) * 9 * (n + 1));
+    dx = (double *) malloc(sizeof(double) * (n + 1));
+    dy = (double *) malloc(sizeof(double) * (n + 1));
+    east = (double *) malloc(sizeof(double) * (n + 1));
+    north = (double *) malloc(sizeof(double) * (n + 1));
+    slope = (double *) malloc(sizeof(double) * (n + 1));
+    aspect = (double *) malloc(sizeof(double) * (n + 1));
+    tri = (double *) malloc(sizeof(double) * (n + 1));
+    if (!xs || !ys || !win || !dx || !dy || !east || !north || !slope || !aspect || !tri) {
+        fprintf(stderr, "Failed to allocate terrain: %s\n", strerror(errno));
+        goto err;
+    }
+    for (int i = 0; i < n; i++) {
+        if (!RequestGetPoint(json_object_array_get_idx(points, i), &xs[i], &ys[i])) {
+            evhttp_send_error(req, 400, NULL);
+            goto done;
+        }
+    }
+
+    ContextGetWindows(ctx, n, xs, ys, win, dx, dy);
+    // Neighbors without data (voids, or edges of the coverage) take the
+    // center value, as gdaldem does with -compute_edges.
+    for (int i = 0; i < n * 9; i++) {
+        if (isnan(win[i])) {
+            win[i] = win[4 * n + i % n];
+        }
+    }
+    horn(n, win, dx, dy, east, north, slope, aspect, tri);
+
+    result = json_object_new_array();
+    if (!result) {
+        fprintf(stderr, "Failed to create JSON array for results: %s\n", strerror(errno));
+        goto err;
+    }
+    for (int i = 0; i < n; i++) {
+        json_object *val = NULL;
+        if (!isnan(slope[i])) {
+            val = json_object_new_object();
+            json_object_object_add(val, "slope", json_object_new_double(slope[i]));
+            json_object_object_add(val, "aspect", slope[i] > 0 ? json_object_new_double(aspect[i]) : NULL);
+            if (withTRI) {
+                json_object_object_add(val, "tri", json_object_new_double(tri[i]));
+            }
+        }
+        json_object_array_add(result, val);
+    }
+    RequestLogElapsed("Computed terrain of", n, &start);
+    RequestSendJSON(req, ctx, result);
+    goto done;
+err:
+    evhttp_send_error(req, 500, NULL);
+done:
+    if (result) {
+        json_object_put(result);
+    }
+    if (json) {
+        json_object_put(json);
+    }
+    if (xs) {
+        free(xs);
+    }
+    if (ys) {
+        free(ys);
+    }
+    if (win) {
+        free(win);
+    }
+    if (dx) {
+        free(dx);
+    }
+    if (dy) {
+        free(dy);
+    }
+    if (east) {
+        free(east);
+    }
+    if (north) {
+        free(north);
+    }
+    if (slope) {
+        free(slope);
+    }
+    if (aspect) {
+        free(aspect);
+    }
+    if (tri) {
+        free(tri);
+    }
+}
+
+// Horn's method over planar 3x3 windows laid out as:
+//   a b c
+//   d e f
+//   g h i
+// with rows from north to south and cell sizes in meters. Gradients and
+// the TRI sum of squares are plain arithmetic over contiguous planes, so
+// the compiler is free to vectorize them; the scalar libm calls are left to
+// a second pass. Points without data yield NAN.
+void horn(int n, const double *win, const double *dx, const double *dy,
+            double *__restrict east, double *__restrict north,
+            double *slope, double *aspect, double *__restrict tri) {
+    const double *a = win, *b = win + n, *c = win + 2 * n;
+    const double *d = win + 3 * n, *e = win + 4 * n, *f = win + 5 * n;
+    const double *g = win + 6 * n, *h = win + 7 * n, *k = win + 8 * n;
+    for (int i = 0; i < n; i++) {
+        east[i] = ((c[i] + 2 * f[i] + k[i]) - (a[i] + 2 * d[i] + g[i])) / (8 * dx[i]);
+        north[i] = ((a[i] + 2 * b[i] + c[i]) - (g[i] + 2 * h[i] + k[i])) / (8 * dy[i]);
+        tri[i] = (a[i] - e[i]) * (a[i] - e[i]) + (b[i] - e[i]) * (b[i] - e[i])
+            + (c[i] - e[i]) * (c[i] - e[i]) + (d[i] - e[i]) * (d[i] - e[i])
+            + (f[i] - e[i]) * (f[i] - e[i]) + (g[i] - e[i]) * (g[i] - e[i])
+            + (h[i] - e[i]) * (h[i] - e[i]) + (k[i] - e[i]) * (k[i] - e[i]);
+    }
+    for (int i = 0; i < n; i++) {
+        slope[i] = atan(sqrt(east[i] * east[i] + north[i] * north[i])) * 180.0 / M_PI;
+        aspect[i] = fmod(atan2(-east[i], -north[i]) * 180.0 / M_PI + 360.0, 360.0);
+        tri[i] = sqrt(tri[i]);
+    }
+}
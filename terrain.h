@@ -0,0 +1,8 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+struct evhttp_request;
+
+void terrain_request_cb(struct evhttp_request *req, void *arg);
+
+#endif // TERRAIN_H
@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include <event2/buffer.h>
+#include <event2/http.h>
+#include <json-c/json.h>
+
+#include "context.h"
+#include "geo.h"
+#include "request.h"
+
+#include "visibility.h"
+
+static const double defaultObserverHeight = 2.0;
+static const double defaultTargetHeight = 0.0;
+static const double defaultRefraction = 0.13;
+static const double defaultStep = 30.0;
+static const int maxLineSamples = 100000;
+static const int maxViewshedCells = 500;
+
+static int getNumber(json_object *json, const char *key, double *val);
+static int getPoint(json_object *json, const char *key, double *x, double *y);
+
+// Replies whether the target can be seen from the observer, and the first
+// point blocking the sight if not. Terrain is sampled every 'step' meters
+// along the line, with earth curvature and atmospheric refraction applied.
+void los_request_cb(struct evhttp_request *req, void *arg) {
+    context *ctx = (context *)arg;
+    json_object *json = NULL, *result = NULL, *point = NULL;
+    double *xs = NULL, *ys = NULL, *zs = NULL;
+    double ox, oy, tx, ty, distance, curvature;
+    double observerHeight = defaultObserverHeight;
+    double targetHeight = defaultTargetHeight;
+    double refraction = defaultRefraction;
+    double step = defaultStep;
+    int n, obstruction = -1;
+    struct timeval start;
+
+    if (!RequestAccept(req, ctx)) {
+        return;
+    }
+
+    json = RequestParseJSON(req);
+    if (!json) {
+        return;
+    }
+
+    if (!json_object_is_type(json, json_type_object)
+            || !getPoint(json, "observer", &ox, &oy)
+            || !getPoint(json, "target", &tx, &ty)
+            || !getNumber(json, "observer_height", &observerHeight)
+            || !getNumber(json, "target_height", &targetHeight)
+            || !getNumber(json, "refraction", &refraction)
+            || !getNumber(json, "step", &step)
+            || !isfinite(step) || !(step > 0)) {
+        evhttp_send_error(req, 400, NULL);
+        goto done;
+    }
+
+    gettimeofday(&start, NULL);
+    distance = GeoDistance(ContextIsGeographic(ctx), ox, oy, tx, ty);
+    if (!(distance / step <= maxLineSamples)) {
+        evhttp_send_error(req, 400, NULL);
+        goto done;
+    }
+    n = (int) ceil(distance / step);
+    if (n < 1) {
+        n = 1;
+    }
+
+    xs = (double *) malloc(sizeof(double) * (n + 1));
+    ys = (double *) malloc(sizeof(double) * (n + 1));
+    zs = (double *) malloc(sizeof(double) * (n + 1));
+    if (!xs || !ys || !zs) {
+        fprintf(stderr, "Failed to allocate samples: %s\n", strerror(errno));
+        goto err;
+    }
+    for (int i = 0; i <= n; i++) {
+        double t = (double) i / n;
+        xs[i] = ox + t * (tx - ox);
+        ys[i] = oy + t * (ty - oy);
+    }
+    ContextGetAltitudes(ctx, n + 1, xs, ys, zs);
+
+    result = json_object_new_object();
+    if (!result) {
+        fprintf(stderr, "Failed to create JSON object for result: %s\n", strerror(errno));
+        goto err;
+    }
+    json_object_object_add(result, "distance", json_object_new_double(distance));
+    if (isnan(zs[0]) || isnan(zs[n])) {
+        json_object_object_add(result, "visible", NULL);
+        json_object_object_add(result, "obstruction", NULL);
+    } else {
+        double z0 = zs[0] + observerHeight;
+        double z1 = zs[n] + targetHeight;
+        curvature = (1 - refraction) / (2 * GEO_EARTH_RADIUS);
+        for (int i = 1; i < n; i++) {
+            if (isnan(zs[i])) {
+                continue;
+            }
+            double t = (double) i / n;
+            double d = t * distance;
+            if (zs[i] + d * (distance - d) * curvature > z0 + t * (z1 - z0)) {
+                obstruction = i;
+                break;
+            }
+        }
+        json_object_object_add(result, "visible", json_object_new_boolean(obstruction < 0));
+        if (obstruction >= 0) {
+            point = json_object_new_array();
+            json_object_array_add(point, json_object_new_double(xs[obstruction]));
+            json_object_array_add(point, json_object_new_double(ys[obstruction]));
+            json_object_array_add(point, json_object_new_double(zs[obstruction]));
+        }
+        json_object_object_add(result, "obstruction", point);
+    }
+    RequestLogElapsed("Traced line of sight with", n + 1, &start);
+    RequestSendJSON(req, ctx, result);
+    goto done;
+err:
+    evhttp_send_error(req, 500, NULL);
+done:
+    if (result) {
+        json_object_put(result);
+    }
+    if (json) {
+        json_object_put(json);
+    }
+    if (xs) {
+        free(xs);
+    }
+    if (ys) {
+        free(ys);
+    }
+    if (zs) {
+        free(zs);
+    }
+}
+
+// Replies a square raster centered at the observer, telling which cells
+// within 'radius' meters are visible. Elevations of the whole square are
+// looked up in a single row-major batch, then rays towards every cell on the
+// border are marched outward in lockstep, keeping the highest horizon slope
+// seen by each ray so far.
+void viewshed_request_cb(struct evhttp_request *req, void *arg) {
+    context *ctx = (context *)arg;
+    json_object *json = NULL;
+    evbuffer *output = NULL;
+    double *xs = NULL, *ys = NULL, *zs = NULL;
+    double *dirX = NULL, *dirY = NULL, *horizon = NULL, *dist = NULL;
+    int *cells = NULL;
+    signed char *visible = NULL;
+    double ox, oy, z0, curvature, top, left, bottom, right;
+    double radius = NAN;
+    double observerHeight = defaultObserverHeight;
+    double targetHeight = defaultTargetHeight;
+    double refraction = defaultRefraction;
+    double resolution = defaultStep;
+    int geographic, n, size, rays;
+    struct timeval start;
+
+    if (!RequestAccept(req, ctx)) {
+        return;
+    }
+
+    json = RequestParseJSON(req);
+    if (!json) {
+        return;
+    }
+
+    if (!json_object_is_type(json, json_type_object)
+            || !getPoint(json, "observer", &ox, &oy)
+            || !getNumber(json, "radius", &radius)
+            || !getNumber(json, "observer_height", &observerHeight)
+            || !getNumber(json, "target_height", &targetHeight)
+            || !getNumber(json, "refraction", &refraction)
+            || !getNumber(json, "resolution", &resolution)
+            || !isfinite(radius) || !(radius > 0)
+            || !isfinite(resolution) || !(resolution > 0)
+            || !(radius / resolution <= maxViewshedCells)) {
+        evhttp_send_error(req, 400, NULL);
+        goto done;
+    }
+    n = (int) ceil(radius / resolution);
+    if (n < 1) {
+        evhttp_send_error(req, 400, NULL);
+        goto done;
+    }
+
+    gettimeofday(&start, NULL);
+    geographic = ContextIsGeographic(ctx);
+    size = 2 * n + 1;
+    rays = 8 * n;
+
+    xs = (double *) malloc(sizeof(double) * size * size);
+    ys = (double *) malloc(sizeof(double) * size * size);
+    zs = (double *) malloc(sizeof(double) * size * size);
+    visible = (signed char *) malloc(size * size);
+    dirX = (double *) malloc(sizeof(double) * rays);
+    dirY = (double *) malloc(sizeof(double) * rays);
+    horizon = (double *) malloc(sizeof(double) * rays);
+    dist = (double *) malloc(sizeof(double) * rays);
+    cells = (int *) malloc(sizeof(int) * rays);
+    if (!xs || !ys || !zs || !visible || !dirX || !dirY || !horizon || !dist || !cells) {
+        fprintf(stderr, "Failed to allocate viewshed: %s\n", strerror(errno));
+        goto err;
+    }
+
+    for (int r = 0; r < size; r++) {
+        for (int c = 0; c < size; c++) {
+            GeoOffset(geographic, ox, oy, (c - n) * resolution, (n - r) * resolution,
+                &xs[r * size + c], &ys[r * size + c]);
+        }
+    }
+    ContextGetAltitudes(ctx, size * size, xs, ys, zs);
+    memset(visible, -1, size * size);
+
+    z0 = zs[n * size + n];
+    if (!isnan(z0)) {
+        z0 += observerHeight;
+        visible[n * size + n] = 1;
+        for (int i = -n, j = 0; i <= n; i++) {
+            dirX[j] = (double) i / n;
+            dirY[j++] = 1;
+            dirX[j] = (double) i / n;
+            dirY[j++] = -1;
+            if (i > -n && i < n) {
+                dirX[j] = 1;
+                dirY[j++] = (double) i / n;
+                dirX[j] = -1;
+                dirY[j++] = (double) i / n;
+            }
+        }
+        for (int j = 0; j < rays; j++) {
+            horizon[j] = -INFINITY;
+        }
+        curvature = (1 - refraction) / (2 * GEO_EARTH_RADIUS);
+        for (int k = 1; k <= n; k++) {
+            // Locate the k-th cell of every ray first, in a loop without
+            // branches or libm calls besides sqrt (inlined with
+            // -fno-math-errno), so the compiler is free to vectorize it.
+            // Offsets are rounded by truncating after shifting them positive.
+            for (int j = 0; j < rays; j++) {
+                int ix = (int) (dirX[j] * k + n + 0.5) - n;
+                int iy = (int) (dirY[j] * k + n + 0.5) - n;
+                dist[j] = sqrt((double) (ix * ix + iy * iy)) * resolution;
+                cells[j] = (n - iy) * size + (n + ix);
+            }
+            for (int j = 0; j < rays; j++) {
+                int cell = cells[j];
+                double d = dist[j];
+                if (d > radius || isnan(zs[cell])) {
+                    continue;
+                }
+                double h = zs[cell] - d * d * curvature;
+                double slope = (h - z0) / d;
+                if ((h + targetHeight - z0) / d >= horizon[j]) {
+                    visible[cell] = 1;
+                } else if (visible[cell] < 0) {
+                    visible[cell] = 0;
+                }
+                if (slope > horizon[j]) {
+                    horizon[j] = slope;
+                }
+            }
+        }
+    }
+
+    output = evbuffer_new();
+    if (!output) {
+        fprintf(stderr, "Failed to allocate output buffer: %s\n", strerror(errno));
+        goto err;
+    }
+    GeoOffset(geographic, ox, oy, -(n + 0.5) * resolution, (n + 0.5) * resolution, &left, &top);
+    GeoOffset(geographic, ox, oy, (n + 0.5) * resolution, -(n + 0.5) * resolution, &right, &bottom);
+    if (evbuffer_add_printf(output, "{\"size\":%d,\"resolution\":%g,\"bounds\":[%.7f,%.7f,%.7f,%.7f],\"visible\":[",
+                size, resolution, top, left, bottom, right) < 0) {
+        fprintf(stderr, "Failed to dump viewshed: %s\n", strerror(errno));
+        goto err;
+    }
+    for (int r = 0; r < size; r++) {
+        evbuffer_add(output, r ? ",[" : "[", r ? 2 : 1);
+        for (int c = 0; c < size; c++) {
+            signed char v = visible[r * size + c];
+            const char *s = v < 0 ? "null" : (v ? "1" : "0");
+            if (c) {
+                evbuffer_add(output, ",", 1);
+            }
+            evbuffer_add(output, s, strlen(s));
+        }
+        evbuffer_add(output, "]", 1);
+    }
+    if (evbuffer_add(output, "]}\n", 3) != 0) {
+        fprintf(stderr, "Failed to dump viewshed: %s\n", strerror(errno));
+        goto err;
+    }
+    RequestLogElapsed("Computed viewshed of", size * size, &start);
+    RequestSendReply(req, ctx, output);
+    goto done;
+err:
+    evhttp_send_error(req, 500, NULL);
+done:
+    if (output) {
+        evbuffer_free(output);
+    }
+    if (json) {
+        json_object_put(json);
+    }
+    if (xs) {
+        free(xs);
+    }
+    if (ys) {
+        free(ys);
+    }
+    if (zs) {
+        free(zs);
+    }
+    if (visible) {
+        free(visible);
+    }
+    if (dirX) {
+        free(dirX);
+    }
+    if (dirY) {
+        free(dirY);
+    }
+    if (horizon) {
+        free(horizon);
+    }
+    if (dist) {
+        free(dist);
+    }
+    if (cells) {
+        free(cells);
+    }
+}
+
+// Reads an optional finite number, leaving the default untouched when absent.
+int getNumber(json_object *json, const char *key, double *val) {
+    json_object *obj;
+    if (!json_object_object_get_ex(json, key, &obj)) {
+        return 1;
+    }
+    return RequestGetNumber(obj, val);
+}
+
+// Reads a mandatory [x,y] coordinate.
+int getPoint(json_object *json, const char *key, double *x, double *y) {
+    json_object *obj;
+    return json_object_object_get_ex(json, key, &obj) && RequestGetPoint(obj, x, y);
+}
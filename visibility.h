@@ -0,0 +1,9 @@
+#ifndef VISIBILITY_H
+#define VISIBILITY_H
+
+struct evhttp_request;
+
+void los_request_cb(struct evhttp_request *req, void *arg);
+void viewshed_request_cb(struct evhttp_request *req, void *arg);
+
+#endif // VISIBILITY_H